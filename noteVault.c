@@ -1,10 +1,40 @@
+#define _CRT_RAND_S             // rand_s() for fresh rotor positions
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <string.h>
+#include <io.h>
 #include <windows.h>
 
+// SSE4.2 has a CRC32C instruction, used when the CPU reports it at runtime
+#if defined(_M_X64) || defined(__x86_64__)
+#define CRC32C_HW_BUILD
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET
+#else
+#include <cpuid.h>
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#endif
+
 #define VAULT_FILENAME "vault-notes.txt"
+#define VAULT_NEXT_FILENAME "vault-notes.next"
+#define REKEY_CHECKPOINT_FILENAME "vault-rekey.chk"
+#define REKEY_CHECKPOINT_TEMP "vault-rekey.tmp"
 #define ALPHABET_SIZE 26
+#define RECORD_LINE_MAX 256
+#define PAGE_RECORDS 10         // records rendered per viewer frame
+#define FRAME_BUFFER_SIZE 8192
+#define CRC32C_POLY 0x82F63B78  // Castagnoli polynomial, bit reflected
+#define MAX_WORKER_THREADS 64
+#define FILE_IO_BUFFER (1 << 20)    // stdio buffer for whole-vault passes
+#define VERIFY_MIN_CHUNK (1 << 20)  // don't split the vault finer than 1MB
+#define VERIFY_MAX_REPORTS 1000     // damaged records listed per thread
+#define NOTE_MAX_LENGTH 100
+#define RECORD_OUT_MAX (RECORD_LINE_MAX + 16)   // room to add a checksum
+#define REKEY_BATCH_RECORDS 8192    // records held in memory at once
 
 
 
@@ -17,6 +47,118 @@ const char *rotorWiring[] =
 const char rotorNotch[] = {'Q', 'E', 'V'};
 const char *reflectorB = "YRUHQSLDPXNGOKMIEBFZCWVJAT";
 
+unsigned int crc32cTable[256];
+int crc32cUseHardware = 0;
+
+
+
+// How much a record can be trusted after parsing
+enum
+{
+    RECORD_OK,          // checksum present and matching
+    RECORD_UNCHECKED,   // written before checksums existed
+    RECORD_DAMAGED      // bad checksum, missing fields or bad rotor values
+};
+
+// Result of reading one raw line of the vault
+enum
+{
+    LINE_END_OF_FILE,
+    LINE_OK,
+    LINE_TOO_LONG       // only the start of the line was kept
+};
+
+// One line of the vault split into its fields (pointers into the line buffer)
+typedef struct
+{
+    char *label;
+    char *message;
+    char *r1;
+    char *r2;
+    char *r3;
+    int status;
+    __int64 offset;     // where the line starts, if the reader tracks it
+} VaultRecord;
+
+// What happened to each line of a re-key batch
+enum
+{
+    REKEY_DONE,
+    REKEY_COPIED,       // damaged, written back unchanged
+    REKEY_TOO_LONG,     // damaged and longer than a line buffer, copied from the vault
+    REKEY_UNCHECKED,    // no checksum to trust its rotors, written back unchanged
+    REKEY_SKIPPED       // empty line, dropped
+};
+
+// How the new rotor positions are chosen
+enum
+{
+    REKEY_FRESH,        // random positions for every note
+    REKEY_DERIVED       // old positions shifted by a fixed triple
+};
+
+// Where a re-key got to, saved after every batch so it can be resumed.
+// vaultSize is there to notice if the vault changed in the meantime
+typedef struct
+{
+    int mode;
+    int shift[3];
+    int legacy;         // also re-key records that have no checksum
+    __int64 vaultSize;
+    __int64 inputOffset;
+    __int64 outputOffset;
+    __int64 records;
+    __int64 copied;
+} RekeyCheckpoint;
+
+// Slice of a batch given to each re-key thread
+typedef struct
+{
+    char (*lines)[RECORD_LINE_MAX];
+    char (*output)[RECORD_OUT_MAX];
+    int *status;
+    int first;
+    int last;
+    int mode;
+    int shift[3];
+    int legacy;
+} RekeyJob;
+
+// Damaged (or, in strict mode, unchecked) record found by a verify
+// thread, numbered within its chunk
+typedef struct
+{
+    __int64 number;
+    int status;
+    char label[32];
+} BadRecord;
+
+// Work given to each verify thread: the records starting in [start, end)
+typedef struct
+{
+    __int64 start;
+    __int64 end;
+    __int64 records;
+    __int64 unchecked;
+    __int64 damaged;
+    BadRecord *reports;
+    int reportCount;
+    int reportCapacity;
+    int strict;         // report records without a checksum too
+    int failed;
+} VerifyJob;
+
+// Sparse index used by the viewer: only the file offset of the first record
+// of each page is kept, and pages are indexed lazily as the user reaches them
+typedef struct
+{
+    FILE *file;
+    __int64 *pageOffsets;
+    int pagesIndexed;
+    int capacity;
+    int totalRecords;   // -1 until the end of the vault has been reached
+} VaultPager;
+
 
 
 void typewriter(const char *text, int delay);
@@ -26,8 +168,27 @@ void setupPlugboard(char plugboard[26]);
 void setRotorPositions();
 void stepRotors(int positions[]);
 void saveToVault(const char *msgLabel, const char *encryptedMessage, const int rotorPositions[3]);
+int formatRecord(char *out, size_t size, const char *msgLabel, const char *encryptedMessage, const int rotorPositions[3]);
 void deleteNote();
 void cleanInput();
+void viewVault();
+
+void initCrc32c();
+unsigned int crc32c(const char *data, size_t length);
+int parseRecord(char *line, VaultRecord *record);
+int readVaultLine(FILE *file, char line[RECORD_LINE_MAX], __int64 *length);
+int readRecord(FILE *file, char line[RECORD_LINE_MAX], VaultRecord *record, __int64 *position);
+int verifyVault(int strict);
+DWORD WINAPI verifyWorker(LPVOID param);
+void rekeyVault();
+DWORD WINAPI rekeyWorker(LPVOID param);
+int saveCheckpoint(const RekeyCheckpoint *checkpoint);
+int rekeyPending();
+int copyVaultLine(FILE *source, FILE *out, __int64 offset, __int64 length);
+int recordPageEnd(VaultPager *pager, int page, int count);
+int ensurePage(VaultPager *pager, int page);
+int findLabel(VaultPager *pager, const char *label, int startRecord);
+void renderPage(VaultPager *pager, int page, int selected, const char *status);
 
 char encryptChar(char c, const char *rotors[], const int positions[], const char *reflector, const char plugboard[26]);
 char plugboardSwap(char c, const char plugboard[26]);
@@ -65,7 +226,9 @@ void printMenu()
             "[2] DECRYPT NOTE\n"
             "[3] VIEW ENCRYPTION LOG\n"
             "[4] DELETE NOTE\n"
-            "[5] EXIT\n";
+            "[5] VERIFY VAULT INTEGRITY\n"
+            "[6] RE-KEY WHOLE VAULT\n"
+            "[7] EXIT\n";
 
         typewriter(menu,50);
         Sleep(1000);
@@ -159,6 +322,22 @@ void createNote()
     fgets(usrMessage, sizeof(usrMessage), stdin);
     usrMessage[strcspn(usrMessage, "\n")] = '\0';
 
+    // '|' separates the fields in the vault file, so it can't be saved as is
+    for (int i = 0; msgLabel[i] != '\0'; i++)
+    {
+        if (msgLabel[i] == '|')
+        {
+            msgLabel[i] = '/';
+        }
+    }
+    for (int i = 0; usrMessage[i] != '\0'; i++)
+    {
+        if (usrMessage[i] == '|')
+        {
+            usrMessage[i] = '/';
+        }
+    }
+
     int rotorPositions[3];
     setRotorPositions(rotorPositions);
 
@@ -302,7 +481,7 @@ char encryptChar(char c, const char *rotors[], const int positions[], const char
 void *encryptNote(char *usrMsg, int rotorPositions[3])
 {
     // Adjust size if you need longer notes
-    char encrypted[100];
+    char encrypted[NOTE_MAX_LENGTH];
     // Initial rotor positions (can be customized)
     // int rotorPositions[3] = {0, 0, 0};
 
@@ -474,11 +653,124 @@ char reflect(char c, const char *reflector)
 
 
 
+/*---------------------------------------------------
+|   Builds the CRC32C lookup table and checks if the
+|   CPU can do it in hardware. Call once at startup
++---------------------------------------------------*/
+void initCrc32c()
+{
+    for (unsigned int i = 0; i < 256; i++)
+    {
+        unsigned int crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        crc32cTable[i] = crc;
+    }
+
+#ifdef CRC32C_HW_BUILD
+    // CPUID leaf 1, ECX bit 20 = SSE4.2
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    crc32cUseHardware = (info[2] >> 20) & 1;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        crc32cUseHardware = (ecx >> 20) & 1;
+    }
+#endif
+#endif
+}
+
+
+
+#ifdef CRC32C_HW_BUILD
+/*---------------------------------------------------
+|   CRC32C using the SSE4.2 instruction, 8 bytes at
+|   a time and then byte by byte for the tail
++---------------------------------------------------*/
+CRC32C_TARGET unsigned int crc32cHardware(const char *data, size_t length)
+{
+    unsigned long long crc = 0xFFFFFFFF;
+
+    while (length >= 8)
+    {
+        unsigned long long chunk;
+        memcpy(&chunk, data, 8);
+        crc = _mm_crc32_u64(crc, chunk);
+        data += 8;
+        length -= 8;
+    }
+
+    unsigned int crc32 = (unsigned int)crc;
+    while (length--)
+    {
+        crc32 = _mm_crc32_u8(crc32, (unsigned char)*data++);
+    }
+
+    return ~crc32;
+}
+#endif
+
+
+
+/*---------------------------------------------------
+|   CRC32C of a buffer, table driven when the CPU
+|   has no SSE4.2
++---------------------------------------------------*/
+unsigned int crc32c(const char *data, size_t length)
+{
+#ifdef CRC32C_HW_BUILD
+    if (crc32cUseHardware)
+    {
+        return crc32cHardware(data, length);
+    }
+#endif
+
+    unsigned int crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = crc32cTable[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+
+
+/*---------------------------------------------------
+|   Writes a vault line (without newline) followed by
+|   a CRC32C of everything before it.
+|   Returns its length, -1 if it doesn't fit
++---------------------------------------------------*/
+int formatRecord(char *out, size_t size, const char *msgLabel, const char *encryptedMessage, const int rotorPositions[3])
+{
+    int length = snprintf(out, size, "%s|%s|%d|%d|%d", msgLabel, encryptedMessage,
+                          rotorPositions[0], rotorPositions[1], rotorPositions[2]);
+    if (length < 0 || (size_t)length + 9 >= size)
+    {
+        return -1;
+    }
+
+    return length + sprintf(out + length, "|%08X", crc32c(out, length));
+}
+
+
+
 /*---------------------------------------------------
 |   Saves label and encrypted message to file
 +---------------------------------------------------*/
 void saveToVault(const char *msgLabel, const char *encryptedMessage, const int rotorPositions[3])
 {
+    if (rekeyPending())
+    {
+        printf("ERROR: A RE-KEY IS WAITING TO BE RESUMED, FINISH IT FIRST. NOTE NOT SAVED...\n");
+        return;
+    }
+
     FILE *file = fopen(VAULT_FILENAME, "a");  // 'a' for append
 
     if (file == NULL)
@@ -490,8 +782,9 @@ void saveToVault(const char *msgLabel, const char *encryptedMessage, const int r
     }
 
     // Write the label and message to file
-    fprintf(file, "%s|%s|%d|%d|%d\n", msgLabel, encryptedMessage,
-            rotorPositions[0], rotorPositions[1], rotorPositions[2]);
+    char record[RECORD_OUT_MAX];
+    formatRecord(record, sizeof(record), msgLabel, encryptedMessage, rotorPositions);
+    fprintf(file, "%s\n", record);
     fclose(file);
     printf(">> ENCRYPTED MESSAGE SAVED TO VAULT\n");
     //printf("\nPRESS ENTER TO RETURN TO MAIN MENU...");
@@ -501,184 +794,1387 @@ void saveToVault(const char *msgLabel, const char *encryptedMessage, const int r
 
 
 /*-----------------------------------------------------
-|   Allows the user to view the list of messages
+|   Splits a vault line (without its newline) into
+|   fields and checks it against its stored CRC32C.
+|   Missing fields are left NULL on damaged records.
+|   Returns the record status
 +----------------------------------------------------*/
-void viewVault()
+int parseRecord(char *line, VaultRecord *record)
 {
-    system("cls");
+    char *fields[6] = {NULL};
+    int count = 0;
 
-    printf("ACCESSING ENCRYPTED FILE SYSTEM...\n\n");
-    printf("[");
-    for (int i = 0; i < 30; i++)
+    // Split by hand so empty fields keep their place
+    char *field = line;
+    while (count < 6)
     {
-        printf("|");
-        Sleep(30);
+        fields[count++] = field;
+        char *bar = strchr(field, '|');
+        if (bar == NULL)
+        {
+            break;
+        }
+        *bar = '\0';
+        field = bar + 1;
     }
-    printf("]\n");
-    Beep(1000, 80);
-    Beep(1400, 80);
-    Sleep(500);
-    system("cls");
 
-    const char *viewNoteBanner =
-        "======================================\n"
-        "=         VIEW ENCRYPTION LOG        =\n"
-        "======================================\n\n";
-    typewriter(viewNoteBanner, 50);
-    Beep(1000,500);
+    record->label = fields[0];
+    record->message = fields[1];
+    record->r1 = fields[2];
+    record->r2 = fields[3];
+    record->r3 = fields[4];
+    record->status = RECORD_DAMAGED;
 
-    FILE *file = fopen(VAULT_FILENAME, "r");
-    if (file == NULL)
+    if (count == 6 && strchr(fields[5], '|') == NULL)
     {
-        printf(">> NO VAULT FILE FOUND...\n");
-        getchar();
-        return;
+        // The checksum covers the line up to the last '|'
+        size_t length = fields[5] - 1 - line;
+        char *end;
+        unsigned long stored = strtoul(fields[5], &end, 16);
+        if (strlen(fields[5]) != 8 || *end != '\0')
+        {
+            return record->status;
+        }
+
+        // Put the separators back to hash the original bytes
+        for (int i = 1; i < 5; i++)
+        {
+            fields[i][-1] = '|';
+        }
+        unsigned int actual = crc32c(line, length);
+        for (int i = 1; i < 5; i++)
+        {
+            fields[i][-1] = '\0';
+        }
+
+        if (actual != stored)
+        {
+            return record->status;
+        }
+        record->status = RECORD_OK;
+    }
+    else if (count == 5)
+    {
+        record->status = RECORD_UNCHECKED;
+    }
+    else
+    {
+        return record->status;
     }
 
-    char line[256];
-    int count = 1;
-    while (fgets(line, sizeof(line), file))
+    // Rotor positions have to be plain numbers from 0 to 25
+    for (int i = 2; i < 5; i++)
     {
-        // Skip empty lines
-        if (line[0] == '\n' || line[0] == '\0')
+        char *end;
+        long position = strtol(fields[i], &end, 10);
+        if (end == fields[i] || *end != '\0' || position < 0 || position >= ALPHABET_SIZE)
         {
-            continue;
+            record->status = RECORD_DAMAGED;
         }
+    }
+
+    return record->status;
+}
+
+
+
+/*-----------------------------------------------------
+|   Reads one raw line of the vault without its line
+|   ending. A line too long for the buffer is consumed
+|   whole so it still counts as a single line.
+|   length is set to the bytes taken from the file
++----------------------------------------------------*/
+int readVaultLine(FILE *file, char line[RECORD_LINE_MAX], __int64 *length)
+{
+    if (fgets(line, RECORD_LINE_MAX, file) == NULL)
+    {
+        return LINE_END_OF_FILE;
+    }
 
-        // Separate label and encrypted message
-        char *label = strtok(line, "|");
-        char *message = strtok(NULL, "|");
-        char *r1 = strtok(NULL, "|");
-        char *r2 = strtok(NULL, "|");
-        char *r3 = strtok(NULL, "\n");
+    int result = LINE_OK;
+    *length = strlen(line);
 
-        if (label && message && r1 && r2 && r3)
+    if (*length > 0 && line[*length - 1] != '\n' && !feof(file))
+    {
+        // No record is this long, skip the rest of it
+        int ch;
+        while ((ch = fgetc(file)) != EOF && ch != '\n')
         {
-            printf("-> [%03d] Label   : %s\n", count, label);
-            printf("         Cipher  : %s\n\n", message);
-            printf("         Rotors  : [%s %s %s]\n\n", r1, r2, r3);
-            count++;
-            Sleep(500);
+            (*length)++;
+        }
+        if (ch == '\n')
+        {
+            (*length)++;
         }
+        result = LINE_TOO_LONG;
     }
 
-    fclose(file);
+    // Vault is read in binary mode, so drop "\r\n" as well as "\n"
+    line[strcspn(line, "\r\n")] = '\0';
 
-    //printf("\nPRESS ENTER TO RETURN TO MAIN MENU...");
-    //getchar();
-    
+    return result;
 }
 
 
 
 /*-----------------------------------------------------
-|   Allows the user to delete a message by using its
-|   label as ID
+|   Reads the next record from the vault, skipping
+|   empty lines. Damaged records are still returned
+|   (check record->status) so numbering stays stable.
+|   If position is given it is moved past every byte
+|   read and record->offset is set.
+|   Returns 1 when a record was read, 0 at end of file
 +----------------------------------------------------*/
-void deleteNote()
+int readRecord(FILE *file, char line[RECORD_LINE_MAX], VaultRecord *record, __int64 *position)
 {
-    system("cls");
+    int result;
+    __int64 length;
 
-    const char *deleteNoteBanner =
-        "======================================\n"
-        "=        DELETE NOTE BY NUMBER       =\n"
-        "======================================\n\n";
-    typewriter(deleteNoteBanner, 50);
-    Beep(1000,500);
+    while ((result = readVaultLine(file, line, &length)) != LINE_END_OF_FILE)
+    {
+        if (position != NULL)
+        {
+            record->offset = *position;
+            *position += length;
+        }
 
-    FILE *file = fopen(VAULT_FILENAME, "r");
-    FILE *temp = fopen("temp.txt", "w");
+        if (line[0] == '\0')
+        {
+            continue;
+        }
 
-    if (file == NULL || temp == NULL)
-    {
-        printf("ERROR: COULD NOT OPEN FILE...\n");
-        getchar();
-        return;
+        parseRecord(line, record);
+        if (result == LINE_TOO_LONG)
+        {
+            record->status = RECORD_DAMAGED;
+        }
+        return 1;
     }
 
-    char line[256];
-    int currentIndex = 1;
-    int targetIndex = 0;
+    return 0;
+}
 
-    typewriter("ENTER NUMBER [N]: ", 50);
-    scanf(" %d", &targetIndex);
 
-    cleanInput();
-    typewriter("\nCONFIRMING CHOICE (Y = Yes / N = No): ", 50);
-    char usrChoice = '\0';
-    scanf(" %c", &usrChoice);
-    usrChoice = toupper(usrChoice);
 
-    switch(usrChoice)
+/*-----------------------------------------------------
+|   Records what reading a page from its start taught
+|   us: where the next page starts if it was full, or
+|   how many notes the vault has if it wasn't. The file
+|   must still be right after the last record read.
+|   Returns 0 if the index couldn't grow
++----------------------------------------------------*/
+int recordPageEnd(VaultPager *pager, int page, int count)
+{
+    if (count < PAGE_RECORDS)
     {
-        case 'Y':
-            while (fgets(line, sizeof(line), file))
-            {
-                if (currentIndex != targetIndex)
-                {
-                    fputs(line, temp);
-                }
-                currentIndex++;
-            }
+        pager->totalRecords = page * PAGE_RECORDS + count;
+        return 1;
+    }
 
-            fclose(file);
-            fclose(temp);
+    if (page + 1 < pager->pagesIndexed)
+    {
+        return 1;
+    }
 
-            remove(VAULT_FILENAME);
-            rename("temp.txt", VAULT_FILENAME);
-    
-            typewriter("\n>> NOTE ", 50);
-            printf("[%d]", targetIndex);
-            typewriter("HAS BEEN DELETED\n", 50);
-            getchar();
-            break;
-        case 'N':
-            typewriter("HALTING DELETION...", 50);
-            getchar();
-            break;
-        default:
-            typewriter("UNRECOGNIZED INPUT...", 50);
-            getchar();
-            break;
+    if (pager->pagesIndexed == pager->capacity)
+    {
+        int newCapacity = pager->capacity * 2;
+        __int64 *grown = realloc(pager->pageOffsets, newCapacity * sizeof(__int64));
+        if (grown == NULL)
+        {
+            return 0;
+        }
+        pager->pageOffsets = grown;
+        pager->capacity = newCapacity;
     }
 
+    pager->pageOffsets[pager->pagesIndexed++] = _ftelli64(pager->file);
+    return 1;
 }
 
 
 
-/*--------------------------
-|   MAIN FUNCTION
-+-------------------------*/
-int main()
+/*-----------------------------------------------------
+|   Makes sure the offset of the given page is known,
+|   scanning forward from the last indexed page only as
+|   far as needed. Returns how many records the page
+|   holds, 0 if it is past the end of the vault
++----------------------------------------------------*/
+int ensurePage(VaultPager *pager, int page)
 {
-    int usrChoice = 0;
+    char line[RECORD_LINE_MAX];
+    VaultRecord record;
 
-    system("cls");
-    system("color 0a");
+    while (page >= pager->pagesIndexed)
+    {
+        if (pager->totalRecords >= 0)
+        {
+            return 0;
+        }
 
-    Beep(1000,500);
-    const char *message = "ACCESS GRANTED. WELCOME TO ENIGMA VAULT...\n";
-    typewriter(message, 50); // 50ms delay per character
+        // Skip over the last indexed page to find where the next one starts
+        int last = pager->pagesIndexed - 1;
+        _fseeki64(pager->file, pager->pageOffsets[last], SEEK_SET);
 
-    while(1)
+        int read = 0;
+        while (read < PAGE_RECORDS && readRecord(pager->file, line, &record, NULL))
+        {
+            read++;
+        }
+
+        if (!recordPageEnd(pager, last, read))
+        {
+            return 0;
+        }
+    }
+
+    // Knowing where the page starts doesn't mean it has records in it,
+    // the last one may start right at end of file or be partly filled
+    _fseeki64(pager->file, pager->pageOffsets[page], SEEK_SET);
+
+    int count = 0;
+    while (count < PAGE_RECORDS && readRecord(pager->file, line, &record, NULL))
     {
-        printMenu();
+        count++;
+    }
+    recordPageEnd(pager, page, count);
 
-        scanf(" %d", &usrChoice);
+    return count;
+}
 
-        switch(usrChoice)
+
+
+/*-----------------------------------------------------
+|   Looks for a label (case insensitive) starting from
+|   the given record and wrapping around once.
+|   Returns the record number or -1 if not found
++----------------------------------------------------*/
+int findLabel(VaultPager *pager, const char *label, int startRecord)
+{
+    char line[RECORD_LINE_MAX];
+    VaultRecord record;
+
+    // Walk page by page, reading each one once. Every full page read
+    // indexes the next one, so ensurePage is only needed to reach the
+    // first page of the search
+    int page = startRecord / PAGE_RECORDS;
+    int wrapped = 0;
+
+    while (1)
+    {
+        int count = 0;
+
+        if (page < pager->pagesIndexed || ensurePage(pager, page))
         {
-            case 1:
-                typewriter(">> CREATING NEW ENCRYPTED NOTE...\n", 50);
-                Sleep(1500);
-                checkFile();
-                cleanInput();
-                createNote();
-                break;
-            case 2:
-                typewriter(">> DECRYPTING NOTE...\n", 50);
-                Sleep(1500);
-                cleanInput();
+            _fseeki64(pager->file, pager->pageOffsets[page], SEEK_SET);
+
+            while (count < PAGE_RECORDS && readRecord(pager->file, line, &record, NULL))
+            {
+                int number = page * PAGE_RECORDS + count++;
+                if (wrapped && number >= startRecord)
+                {
+                    return -1;
+                }
+                if ((wrapped || number >= startRecord) && _stricmp(record.label, label) == 0)
+                {
+                    return number;
+                }
+            }
+            recordPageEnd(pager, page, count);
+        }
+
+        if (count < PAGE_RECORDS)
+        {
+            // End of vault, go back to the start unless it was searched already
+            if (wrapped || startRecord == 0)
+            {
+                return -1;
+            }
+            page = 0;
+            wrapped = 1;
+            continue;
+        }
+
+        page++;
+    }
+}
+
+
+
+/*-----------------------------------------------------
+|   Builds a whole page into one buffer and writes it
+|   to the screen in a single call
++----------------------------------------------------*/
+void renderPage(VaultPager *pager, int page, int selected, const char *status)
+{
+    char frame[FRAME_BUFFER_SIZE];
+    char line[RECORD_LINE_MAX];
+    VaultRecord record;
+    int len = 0;
+
+    len += snprintf(frame + len, sizeof(frame) - len,
+        "======================================\n"
+        "=         VIEW ENCRYPTION LOG        =\n"
+        "======================================\n\n");
+
+    _fseeki64(pager->file, pager->pageOffsets[page], SEEK_SET);
+
+    int shown = 0;
+    for (; shown < PAGE_RECORDS && readRecord(pager->file, line, &record, NULL); shown++)
+    {
+        int number = page * PAGE_RECORDS + shown;
+        if (record.status == RECORD_DAMAGED)
+        {
+            len += snprintf(frame + len, sizeof(frame) - len,
+                "%s [%03d] Label   : %.30s\n"
+                "         !! RECORD DAMAGED, CANNOT BE TRUSTED\n\n",
+                number == selected ? ">>" : "->", number + 1, record.label);
+            continue;
+        }
+
+        len += snprintf(frame + len, sizeof(frame) - len,
+            "%s [%03d] Label   : %s\n"
+            "         Cipher  : %s\n"
+            "         Rotors  : [%s %s %s]\n\n",
+            number == selected ? ">>" : "->", number + 1, record.label,
+            record.message, record.r1, record.r2, record.r3);
+    }
+
+    if (shown == 0)
+    {
+        len += snprintf(frame + len, sizeof(frame) - len, ">> VAULT IS EMPTY\n\n");
+    }
+
+    if (pager->totalRecords >= 0)
+    {
+        int pages = (pager->totalRecords + PAGE_RECORDS - 1) / PAGE_RECORDS;
+        len += snprintf(frame + len, sizeof(frame) - len, "PAGE %d OF %d (%d NOTES)\n",
+                        page + 1, pages > 0 ? pages : 1, pager->totalRecords);
+    }
+    else
+    {
+        len += snprintf(frame + len, sizeof(frame) - len, "PAGE %d\n", page + 1);
+    }
+
+    len += snprintf(frame + len, sizeof(frame) - len,
+        "%s\n[N]EXT  [P]REV  [G]OTO <NUMBER>  [L]ABEL <TEXT>  [Q]UIT\nCOMMAND: ",
+        status);
+
+    if (len >= (int)sizeof(frame))
+    {
+        len = sizeof(frame) - 1;
+    }
+
+    system("cls");
+    fwrite(frame, 1, len, stdout);
+    fflush(stdout);
+}
+
+
+
+/*-----------------------------------------------------
+|   Allows the user to view the list of messages one
+|   page at a time, only reading the visible records
++----------------------------------------------------*/
+void viewVault()
+{
+    FILE *file = fopen(VAULT_FILENAME, "rb");
+    if (file == NULL)
+    {
+        printf(">> NO VAULT FILE FOUND...\n");
+        getchar();
+        return;
+    }
+
+    VaultPager pager;
+    pager.file = file;
+    pager.capacity = 64;
+    pager.pageOffsets = malloc(pager.capacity * sizeof(__int64));
+    if (pager.pageOffsets == NULL)
+    {
+        printf("ERROR: OUT OF MEMORY...\n");
+        fclose(file);
+        return;
+    }
+    pager.pageOffsets[0] = 0;
+    pager.pagesIndexed = 1;
+    pager.totalRecords = -1;
+
+    Beep(1000, 80);
+    Beep(1400, 80);
+
+    int page = 0;
+    int selected = -1;
+    char status[128] = "";
+    char input[64];
+
+    while (1)
+    {
+        renderPage(&pager, page, selected, status);
+        status[0] = '\0';
+
+        if (fgets(input, sizeof(input), stdin) == NULL)
+        {
+            break;
+        }
+        input[strcspn(input, "\r\n")] = '\0';
+
+        // Argument follows the command letter, a bare number means GOTO
+        char command = toupper(input[0]);
+        char *arg = input + 1;
+        if (isdigit(input[0]))
+        {
+            command = 'G';
+            arg = input;
+        }
+        while (*arg == ' ')
+        {
+            arg++;
+        }
+
+        switch (command)
+        {
+            case '\0':
+            case 'N':
+                if (ensurePage(&pager, page + 1))
+                {
+                    page++;
+                    selected = -1;
+                }
+                else
+                {
+                    strcpy(status, ">> END OF VAULT");
+                }
+                break;
+            case 'P':
+                if (page > 0)
+                {
+                    page--;
+                    selected = -1;
+                }
+                else
+                {
+                    strcpy(status, ">> START OF VAULT");
+                }
+                break;
+            case 'G':
+            {
+                int number = atoi(arg);
+                if (number >= 1 && ensurePage(&pager, (number - 1) / PAGE_RECORDS)
+                                   > (number - 1) % PAGE_RECORDS)
+                {
+                    page = (number - 1) / PAGE_RECORDS;
+                    selected = number - 1;
+                }
+                else
+                {
+                    snprintf(status, sizeof(status), ">> NO NOTE NUMBER %s", arg);
+                }
+                break;
+            }
+            case 'L':
+            {
+                int start = selected >= 0 ? selected + 1 : page * PAGE_RECORDS;
+                int found = findLabel(&pager, arg, start);
+                if (found >= 0)
+                {
+                    page = found / PAGE_RECORDS;
+                    selected = found;
+                }
+                else
+                {
+                    snprintf(status, sizeof(status), ">> LABEL NOT FOUND: %.60s", arg);
+                }
+                break;
+            }
+            case 'Q':
+                free(pager.pageOffsets);
+                fclose(file);
+                return;
+            default:
+                strcpy(status, ">> UNRECOGNIZED COMMAND");
+                break;
+        }
+    }
+
+    free(pager.pageOffsets);
+    fclose(file);
+}
+
+
+
+/*-----------------------------------------------------
+|   Verify thread: checks every record that starts
+|   inside its chunk of the vault
++----------------------------------------------------*/
+DWORD WINAPI verifyWorker(LPVOID param)
+{
+    VerifyJob *job = (VerifyJob *)param;
+
+    FILE *file = fopen(VAULT_FILENAME, "rb");
+    if (file == NULL)
+    {
+        job->failed = 1;
+        return 1;
+    }
+    setvbuf(file, NULL, _IOFBF, FILE_IO_BUFFER);
+
+    // A chunk owns the lines that start inside it, so unless the byte
+    // before the chunk is a newline, skip to the start of the next line
+    __int64 pos = job->start;
+    if (pos > 0)
+    {
+        _fseeki64(file, pos - 1, SEEK_SET);
+        int ch;
+        while ((ch = fgetc(file)) != EOF && ch != '\n')
+        {
+            pos++;
+        }
+    }
+
+    char line[RECORD_LINE_MAX];
+    VaultRecord record;
+
+    while (pos < job->end && readRecord(file, line, &record, &pos))
+    {
+        // Empty lines are skipped, so the record may start in the next chunk
+        if (record.offset >= job->end)
+        {
+            break;
+        }
+
+        job->records++;
+
+        if (record.status == RECORD_UNCHECKED)
+        {
+            job->unchecked++;
+        }
+        else if (record.status == RECORD_DAMAGED)
+        {
+            job->damaged++;
+        }
+
+        // A line cut right before its checksum looks just like an old
+        // record, so strict mode lists those as well
+        if (record.status == RECORD_DAMAGED || (job->strict && record.status == RECORD_UNCHECKED))
+        {
+            if (job->reportCount == job->reportCapacity && job->reportCapacity < VERIFY_MAX_REPORTS)
+            {
+                int newCapacity = job->reportCapacity ? job->reportCapacity * 2 : 16;
+                BadRecord *grown = realloc(job->reports, newCapacity * sizeof(BadRecord));
+                if (grown != NULL)
+                {
+                    job->reports = grown;
+                    job->reportCapacity = newCapacity;
+                }
+            }
+
+            if (job->reportCount < job->reportCapacity)
+            {
+                BadRecord *bad = &job->reports[job->reportCount++];
+                bad->number = job->records;
+                bad->status = record.status;
+                snprintf(bad->label, sizeof(bad->label), "%s", record.label);
+            }
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+
+
+/*-----------------------------------------------------
+|   Checks every record of the vault against its CRC32C,
+|   splitting the file across one thread per CPU.
+|   In strict mode records without a checksum count
+|   as bad too, for vaults that have been re-saved or
+|   re-keyed since checksums were added.
+|   Returns the number of bad records, -1 on error
++----------------------------------------------------*/
+int verifyVault(int strict)
+{
+    FILE *file = fopen(VAULT_FILENAME, "rb");
+    if (file == NULL)
+    {
+        printf(">> NO VAULT FILE FOUND...\n");
+        return -1;
+    }
+    _fseeki64(file, 0, SEEK_END);
+    __int64 size = _ftelli64(file);
+    fclose(file);
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int threads = info.dwNumberOfProcessors;
+    if (threads > MAX_WORKER_THREADS)
+    {
+        threads = MAX_WORKER_THREADS;
+    }
+    if (size / VERIFY_MIN_CHUNK + 1 < threads)
+    {
+        threads = (int)(size / VERIFY_MIN_CHUNK) + 1;
+    }
+
+    VerifyJob jobs[MAX_WORKER_THREADS];
+    HANDLE handles[MAX_WORKER_THREADS];
+    memset(jobs, 0, sizeof(jobs));
+
+    DWORD startTime = GetTickCount();
+
+    for (int i = 0; i < threads; i++)
+    {
+        jobs[i].start = size * i / threads;
+        jobs[i].end = size * (i + 1) / threads;
+        jobs[i].strict = strict;
+        handles[i] = CreateThread(NULL, 0, verifyWorker, &jobs[i], 0, NULL);
+        if (handles[i] == NULL)
+        {
+            // Couldn't start a thread, do this chunk here instead
+            verifyWorker(&jobs[i]);
+        }
+    }
+
+    for (int i = 0; i < threads; i++)
+    {
+        if (handles[i] != NULL)
+        {
+            WaitForSingleObject(handles[i], INFINITE);
+            CloseHandle(handles[i]);
+        }
+    }
+
+    DWORD elapsed = GetTickCount() - startTime;
+
+    // Chunks count records locally, turn that into vault wide numbers
+    __int64 records = 0;
+    __int64 unchecked = 0;
+    __int64 damaged = 0;
+    int failed = 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+        for (int j = 0; j < jobs[i].reportCount; j++)
+        {
+            printf("!! [%03lld] Label   : %s%s\n", records + jobs[i].reports[j].number,
+                   jobs[i].reports[j].label,
+                   jobs[i].reports[j].status == RECORD_UNCHECKED ? " (NO CHECKSUM)" : "");
+        }
+
+        __int64 bad = jobs[i].damaged + (strict ? jobs[i].unchecked : 0);
+        if (bad > jobs[i].reportCount)
+        {
+            printf("!! ... %lld MORE BAD RECORDS IN THIS PART OF THE VAULT\n",
+                   bad - jobs[i].reportCount);
+        }
+
+        records += jobs[i].records;
+        unchecked += jobs[i].unchecked;
+        damaged += jobs[i].damaged;
+        failed |= jobs[i].failed;
+        free(jobs[i].reports);
+    }
+
+    if (failed)
+    {
+        printf("ERROR: COULD NOT OPEN FILE...\n");
+        return -1;
+    }
+
+    printf("\n>> RECORDS CHECKED : %lld\n", records);
+    printf(">> DAMAGED         : %lld\n", damaged);
+    printf(">> NO CHECKSUM     : %lld%s\n", unchecked, strict ? " (COUNTED AS BAD)" : "");
+    printf(">> TIME            : %lu ms (%d THREADS, %s CRC32C)\n",
+           (unsigned long)elapsed, threads, crc32cUseHardware ? "SSE4.2" : "TABLE");
+
+    __int64 bad = damaged + (strict ? unchecked : 0);
+    return bad > 0x7FFFFFFF ? 0x7FFFFFFF : (int)bad;
+}
+
+
+
+/*-----------------------------------------------------
+|   Re-key thread: decrypts each line of its slice with
+|   the stored positions and encrypts it again with
+|   new ones
++----------------------------------------------------*/
+DWORD WINAPI rekeyWorker(LPVOID param)
+{
+    RekeyJob *job = (RekeyJob *)param;
+    VaultRecord record;
+
+    for (int i = job->first; i < job->last; i++)
+    {
+        if (job->status[i] == REKEY_TOO_LONG)
+        {
+            continue;
+        }
+
+        if (job->lines[i][0] == '\0')
+        {
+            job->status[i] = REKEY_SKIPPED;
+            continue;
+        }
+
+        // parseRecord cuts the line up, keep the original for copying
+        char line[RECORD_LINE_MAX];
+        strcpy(line, job->lines[i]);
+
+        int recordStatus = parseRecord(line, &record);
+        if (recordStatus == RECORD_DAMAGED || strlen(record.message) >= NOTE_MAX_LENGTH)
+        {
+            strcpy(job->output[i], job->lines[i]);
+            job->status[i] = REKEY_COPIED;
+            continue;
+        }
+
+        // Without a checksum a cut rotor field can't be told apart from a
+        // real one, and re-keying would seal the garbage under a new CRC
+        if (recordStatus == RECORD_UNCHECKED && !job->legacy)
+        {
+            strcpy(job->output[i], job->lines[i]);
+            job->status[i] = REKEY_UNCHECKED;
+            continue;
+        }
+
+        int oldPositions[3] = {atoi(record.r1), atoi(record.r2), atoi(record.r3)};
+        int newPositions[3];
+
+        for (int r = 0; r < 3; r++)
+        {
+            if (job->mode == REKEY_DERIVED)
+            {
+                newPositions[r] = (oldPositions[r] + job->shift[r]) % ALPHABET_SIZE;
+            }
+            else
+            {
+                unsigned int random = 0;
+                rand_s(&random);
+                newPositions[r] = random % ALPHABET_SIZE;
+            }
+        }
+
+        // Enigma is reciprocal, the same machine decrypts and encrypts
+        char *plain = encryptNote(record.message, oldPositions);
+        char *cipher = encryptNote(plain, newPositions);
+
+        if (formatRecord(job->output[i], RECORD_OUT_MAX, record.label, cipher, newPositions) < 0)
+        {
+            strcpy(job->output[i], job->lines[i]);
+            job->status[i] = REKEY_COPIED;
+        }
+        else
+        {
+            job->status[i] = REKEY_DONE;
+        }
+
+        free(plain);
+        free(cipher);
+    }
+
+    return 0;
+}
+
+
+
+/*-----------------------------------------------------
+|   Saves re-key progress, going through a temp file
+|   so a crash never leaves half a checkpoint.
+|   Returns 0 on success
++----------------------------------------------------*/
+int saveCheckpoint(const RekeyCheckpoint *checkpoint)
+{
+    FILE *file = fopen(REKEY_CHECKPOINT_TEMP, "w");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    fprintf(file, "%d %d %d %d %d %lld %lld %lld %lld %lld\n", checkpoint->mode,
+            checkpoint->shift[0], checkpoint->shift[1], checkpoint->shift[2], checkpoint->legacy,
+            checkpoint->vaultSize, checkpoint->inputOffset,
+            checkpoint->outputOffset, checkpoint->records, checkpoint->copied);
+    fflush(file);
+    _commit(_fileno(file));
+    fclose(file);
+
+    if (!MoveFileEx(REKEY_CHECKPOINT_TEMP, REKEY_CHECKPOINT_FILENAME,
+                    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+
+/*-----------------------------------------------------
+|   An interrupted re-key resumes from a byte offset in
+|   the vault, so the vault must not change until the
+|   re-key is finished. Once the new vault has been
+|   swapped in (no .next file left) nothing is pending.
+|   Returns 1 while a re-key is waiting to be resumed
++----------------------------------------------------*/
+int rekeyPending()
+{
+    FILE *checkpoint = fopen(REKEY_CHECKPOINT_FILENAME, "r");
+    if (checkpoint == NULL)
+    {
+        return 0;
+    }
+    fclose(checkpoint);
+
+    FILE *next = fopen(VAULT_NEXT_FILENAME, "rb");
+    if (next == NULL)
+    {
+        return 0;
+    }
+    fclose(next);
+
+    return 1;
+}
+
+
+
+/*-----------------------------------------------------
+|   Copies one line of the vault byte for byte from
+|   its offset, ending it with "\r\n" like the rest of
+|   the vault. Used for lines too long to be held in a
+|   line buffer. Returns 0 on success
++----------------------------------------------------*/
+int copyVaultLine(FILE *source, FILE *out, __int64 offset, __int64 length)
+{
+    char buffer[4096];
+
+    // Leave out the line's own ending, whatever it was
+    __int64 content = length;
+    if (content > 0)
+    {
+        _fseeki64(source, offset + content - 1, SEEK_SET);
+        if (fgetc(source) == '\n')
+        {
+            content--;
+        }
+    }
+    if (content > 0)
+    {
+        _fseeki64(source, offset + content - 1, SEEK_SET);
+        if (fgetc(source) == '\r')
+        {
+            content--;
+        }
+    }
+
+    _fseeki64(source, offset, SEEK_SET);
+    while (content > 0)
+    {
+        size_t chunk = content < (__int64)sizeof(buffer) ? (size_t)content : sizeof(buffer);
+        if (fread(buffer, 1, chunk, source) != chunk || fwrite(buffer, 1, chunk, out) != chunk)
+        {
+            return -1;
+        }
+        content -= chunk;
+    }
+
+    return fputs("\r\n", out) < 0 ? -1 : 0;
+}
+
+
+
+/*-----------------------------------------------------
+|   Moves every note to new rotor positions. The vault
+|   is streamed once in batches, each batch re-keyed
+|   by one thread per CPU, into a new vault file that
+|   replaces the old one only once it is complete.
+|   Progress is checkpointed after every batch so an
+|   interrupted run can pick up where it stopped
++----------------------------------------------------*/
+void rekeyVault()
+{
+    system("cls");
+
+    const char *rekeyBanner =
+        "======================================\n"
+        "=          RE-KEY WHOLE VAULT        =\n"
+        "======================================\n\n";
+    typewriter(rekeyBanner, 50);
+    Beep(1000,500);
+
+    FILE *vault = fopen(VAULT_FILENAME, "rb");
+    if (vault == NULL)
+    {
+        printf(">> NO VAULT FILE FOUND...\n");
+        return;
+    }
+    _fseeki64(vault, 0, SEEK_END);
+    __int64 vaultSize = _ftelli64(vault);
+
+    RekeyCheckpoint checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    int resuming = 0;
+    char usrChoice = '\0';
+
+    FILE *saved = fopen(REKEY_CHECKPOINT_FILENAME, "r");
+    if (saved != NULL)
+    {
+        int fields = fscanf(saved, "%d %d %d %d %d %lld %lld %lld %lld %lld", &checkpoint.mode,
+                            &checkpoint.shift[0], &checkpoint.shift[1], &checkpoint.shift[2],
+                            &checkpoint.legacy,
+                            &checkpoint.vaultSize, &checkpoint.inputOffset,
+                            &checkpoint.outputOffset, &checkpoint.records, &checkpoint.copied);
+        fclose(saved);
+
+        FILE *next = fopen(VAULT_NEXT_FILENAME, "rb");
+        if (next == NULL)
+        {
+            // Crashed after the swap, only the checkpoint was left behind
+            remove(REKEY_CHECKPOINT_FILENAME);
+        }
+        else if (fields == 10 && checkpoint.vaultSize == vaultSize)
+        {
+            fclose(next);
+            typewriter("INTERRUPTED RE-KEY FOUND, ", 50);
+            printf("%lld NOTES ALREADY DONE.\n", checkpoint.records);
+            typewriter("RESUME IT (Y = Yes / N = Start over): ", 50);
+            scanf(" %c", &usrChoice);
+            cleanInput();
+            resuming = (toupper(usrChoice) == 'Y');
+        }
+        else
+        {
+            fclose(next);
+            typewriter(">> VAULT CHANGED SINCE THE LAST RE-KEY, STARTING OVER\n", 50);
+        }
+    }
+
+    if (!resuming)
+    {
+        memset(&checkpoint, 0, sizeof(checkpoint));
+        checkpoint.vaultSize = vaultSize;
+
+        typewriter("NEW POSITIONS (F = Fresh random / D = Derive by shifting): ", 50);
+        scanf(" %c", &usrChoice);
+        cleanInput();
+
+        switch (toupper(usrChoice))
+        {
+            case 'F':
+                checkpoint.mode = REKEY_FRESH;
+                break;
+            case 'D':
+            {
+                checkpoint.mode = REKEY_DERIVED;
+                typewriter("ENTER SHIFT FOR EACH ROTOR (3 LETTERS A-Z, A = NO SHIFT): ", 50);
+
+                char input[10];
+                fgets(input, sizeof(input), stdin);
+
+                char *token = strtok(input, " \n");
+                for (int i = 0; i < 3; i++)
+                {
+                    char ch = token ? toupper(token[0]) : 'A';
+                    checkpoint.shift[i] = (ch >= 'A' && ch <= 'Z') ? ch - 'A' : 0;
+                    token = strtok(NULL, " \n");
+                }
+
+                if (checkpoint.shift[0] == 0 && checkpoint.shift[1] == 0 && checkpoint.shift[2] == 0)
+                {
+                    typewriter(">> A A A WOULD KEEP THE SAME POSITIONS, HALTING RE-KEY...\n", 50);
+                    fclose(vault);
+                    return;
+                }
+                break;
+            }
+            default:
+                typewriter("UNRECOGNIZED INPUT...\n", 50);
+                fclose(vault);
+                return;
+        }
+
+        typewriter("ALSO RE-KEY NOTES SAVED WITHOUT A CHECKSUM? THEIR ROTORS CAN'T BE CHECKED (Y/N): ", 50);
+        scanf(" %c", &usrChoice);
+        cleanInput();
+        checkpoint.legacy = (toupper(usrChoice) == 'Y');
+
+        typewriter("\nCONFIRMING RE-KEY OF EVERY NOTE (Y = Yes / N = No): ", 50);
+        scanf(" %c", &usrChoice);
+        cleanInput();
+        if (toupper(usrChoice) != 'Y')
+        {
+            typewriter("HALTING RE-KEY...\n", 50);
+            fclose(vault);
+            return;
+        }
+    }
+
+    // Throw away anything written after the last checkpoint
+    FILE *next = fopen(VAULT_NEXT_FILENAME, resuming ? "r+b" : "wb");
+    if (next == NULL || (resuming && _chsize_s(_fileno(next), checkpoint.outputOffset) != 0))
+    {
+        printf("ERROR: COULD NOT OPEN FILE...\n");
+        if (next != NULL)
+        {
+            fclose(next);
+        }
+        fclose(vault);
+        return;
+    }
+    _fseeki64(next, checkpoint.outputOffset, SEEK_SET);
+    _fseeki64(vault, checkpoint.inputOffset, SEEK_SET);
+    setvbuf(vault, NULL, _IOFBF, FILE_IO_BUFFER);
+    setvbuf(next, NULL, _IOFBF, FILE_IO_BUFFER);
+
+    if (!resuming && saveCheckpoint(&checkpoint) != 0)
+    {
+        printf("ERROR: COULD NOT SAVE CHECKPOINT...\n");
+        fclose(next);
+        fclose(vault);
+        return;
+    }
+
+    // Second handle on the vault to copy over lines too long for a buffer
+    FILE *source = fopen(VAULT_FILENAME, "rb");
+    char (*lines)[RECORD_LINE_MAX] = malloc(REKEY_BATCH_RECORDS * sizeof(*lines));
+    char (*output)[RECORD_OUT_MAX] = malloc(REKEY_BATCH_RECORDS * sizeof(*output));
+    int *status = malloc(REKEY_BATCH_RECORDS * sizeof(int));
+    __int64 *lineOffsets = malloc(REKEY_BATCH_RECORDS * sizeof(__int64));
+    __int64 *lineLengths = malloc(REKEY_BATCH_RECORDS * sizeof(__int64));
+    if (source == NULL || lines == NULL || output == NULL || status == NULL
+        || lineOffsets == NULL || lineLengths == NULL)
+    {
+        printf("ERROR: OUT OF MEMORY...\n");
+        if (source != NULL)
+        {
+            fclose(source);
+        }
+        free(lines);
+        free(output);
+        free(status);
+        free(lineOffsets);
+        free(lineLengths);
+        fclose(next);
+        fclose(vault);
+        return;
+    }
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int threads = info.dwNumberOfProcessors;
+    if (threads > MAX_WORKER_THREADS)
+    {
+        threads = MAX_WORKER_THREADS;
+    }
+
+    RekeyJob jobs[MAX_WORKER_THREADS];
+    HANDLE handles[MAX_WORKER_THREADS];
+    int failed = 0;
+
+    printf("\n");
+
+    while (!failed)
+    {
+        // Read stage: fill a batch from the current position
+        int count = 0;
+        int result;
+        __int64 consumed = 0;
+        while (count < REKEY_BATCH_RECORDS
+               && (result = readVaultLine(vault, lines[count], &lineLengths[count])) != LINE_END_OF_FILE)
+        {
+            lineOffsets[count] = checkpoint.inputOffset + consumed;
+            consumed += lineLengths[count];
+            status[count] = (result == LINE_TOO_LONG) ? REKEY_TOO_LONG : REKEY_DONE;
+            count++;
+        }
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        // Worker stage: each thread takes an even slice of the batch
+        int used = count < threads ? count : threads;
+        for (int i = 0; i < used; i++)
+        {
+            jobs[i].lines = lines;
+            jobs[i].output = output;
+            jobs[i].status = status;
+            jobs[i].first = count * i / used;
+            jobs[i].last = count * (i + 1) / used;
+            jobs[i].mode = checkpoint.mode;
+            jobs[i].legacy = checkpoint.legacy;
+            memcpy(jobs[i].shift, checkpoint.shift, sizeof(jobs[i].shift));
+            handles[i] = CreateThread(NULL, 0, rekeyWorker, &jobs[i], 0, NULL);
+            if (handles[i] == NULL)
+            {
+                rekeyWorker(&jobs[i]);
+            }
+        }
+
+        for (int i = 0; i < used; i++)
+        {
+            if (handles[i] != NULL)
+            {
+                WaitForSingleObject(handles[i], INFINITE);
+                CloseHandle(handles[i]);
+            }
+        }
+
+        // Write stage: keep the original order
+        for (int i = 0; i < count; i++)
+        {
+            if (status[i] == REKEY_SKIPPED)
+            {
+                continue;
+            }
+
+            checkpoint.records++;
+            if (status[i] == REKEY_COPIED || status[i] == REKEY_TOO_LONG || status[i] == REKEY_UNCHECKED)
+            {
+                checkpoint.copied++;
+                char *original = (status[i] == REKEY_TOO_LONG) ? lines[i] : output[i];
+                char *bar = strchr(original, '|');
+                printf("\r!! [%03lld] Label   : %.*s (%s, COPIED UNCHANGED)\n", checkpoint.records,
+                       (bar && bar - original < 30) ? (int)(bar - original) : 30, original,
+                       status[i] == REKEY_UNCHECKED ? "NO CHECKSUM" : "DAMAGED");
+            }
+
+            if (status[i] == REKEY_TOO_LONG)
+            {
+                if (copyVaultLine(source, next, lineOffsets[i], lineLengths[i]) != 0)
+                {
+                    failed = 1;
+                }
+            }
+            else
+            {
+                fprintf(next, "%s\r\n", output[i]);
+            }
+        }
+
+        // Only checkpoint once the batch is safely on disk
+        if (failed || fflush(next) != 0 || _commit(_fileno(next)) != 0)
+        {
+            printf("\nERROR: COULD NOT WRITE %s...\n", VAULT_NEXT_FILENAME);
+            failed = 1;
+            break;
+        }
+        checkpoint.inputOffset += consumed;
+        checkpoint.outputOffset = _ftelli64(next);
+        if (saveCheckpoint(&checkpoint) != 0)
+        {
+            printf("\nERROR: COULD NOT SAVE CHECKPOINT...\n");
+            failed = 1;
+            break;
+        }
+
+        printf("\r>> %lld NOTES RE-KEYED", checkpoint.records);
+        fflush(stdout);
+    }
+
+    free(lines);
+    free(output);
+    free(status);
+    free(lineOffsets);
+    free(lineLengths);
+    fclose(source);
+    fclose(next);
+    fclose(vault);
+
+    if (failed)
+    {
+        typewriter("\n>> RE-KEY STOPPED, CHOOSE IT AGAIN TO RESUME\n", 50);
+        return;
+    }
+
+    // New generation is complete, swap it in with one rename
+    if (!MoveFileEx(VAULT_NEXT_FILENAME, VAULT_FILENAME, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        printf("\nERROR: COULD NOT REPLACE %s, CHOOSE RE-KEY AGAIN TO RETRY...\n", VAULT_FILENAME);
+        return;
+    }
+    remove(REKEY_CHECKPOINT_FILENAME);
+
+    printf("\n>> %lld NOTES IN VAULT, %lld DAMAGED OR UNCHECKED ONES LEFT AS THEY WERE\n", checkpoint.records, checkpoint.copied);
+    typewriter(">> VAULT RE-KEYED\n", 50);
+}
+
+
+
+/*-----------------------------------------------------
+|   Allows the user to delete a message by using its
+|   label as ID
++----------------------------------------------------*/
+void deleteNote()
+{
+    system("cls");
+
+    const char *deleteNoteBanner =
+        "======================================\n"
+        "=        DELETE NOTE BY NUMBER       =\n"
+        "======================================\n\n";
+    typewriter(deleteNoteBanner, 50);
+    Beep(1000,500);
+
+    if (rekeyPending())
+    {
+        printf("ERROR: A RE-KEY IS WAITING TO BE RESUMED, FINISH IT FIRST...\n");
+        getchar();
+        return;
+    }
+
+    // Second handle copies kept lines byte for byte while the first one
+    // is read line by line for numbering
+    FILE *file = fopen(VAULT_FILENAME, "rb");
+    FILE *source = fopen(VAULT_FILENAME, "rb");
+    FILE *temp = fopen("temp.txt", "wb");
+
+    if (file == NULL || source == NULL || temp == NULL)
+    {
+        printf("ERROR: COULD NOT OPEN FILE...\n");
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        if (source != NULL)
+        {
+            fclose(source);
+        }
+        if (temp != NULL)
+        {
+            fclose(temp);
+            remove("temp.txt");
+        }
+        getchar();
+        return;
+    }
+
+    char line[RECORD_LINE_MAX];
+    char buffer[4096];
+    __int64 length = 0;
+    int currentIndex = 1;
+    int targetIndex = 0;
+    int deleted = 0;
+
+    typewriter("ENTER NUMBER [N]: ", 50);
+    scanf(" %d", &targetIndex);
+
+    cleanInput();
+    typewriter("\nCONFIRMING CHOICE (Y = Yes / N = No): ", 50);
+    char usrChoice = '\0';
+    scanf(" %c", &usrChoice);
+    usrChoice = toupper(usrChoice);
+
+    switch(usrChoice)
+    {
+        case 'Y':
+            // Number notes the way the viewer and verify do: empty lines
+            // don't count and an overlong line is one note
+            while (readVaultLine(file, line, &length) != LINE_END_OF_FILE)
+            {
+                if (line[0] != '\0' && currentIndex++ == targetIndex)
+                {
+                    _fseeki64(source, length, SEEK_CUR);
+                    deleted = 1;
+                    continue;
+                }
+
+                while (length > 0)
+                {
+                    size_t chunk = length < (__int64)sizeof(buffer) ? (size_t)length : sizeof(buffer);
+                    fread(buffer, 1, chunk, source);
+                    fwrite(buffer, 1, chunk, temp);
+                    length -= chunk;
+                }
+            }
+
+            fclose(file);
+            fclose(source);
+            fclose(temp);
+
+            if (!deleted)
+            {
+                remove("temp.txt");
+                typewriter("\n>> NO NOTE NUMBER ", 50);
+                printf("[%d]\n", targetIndex);
+                getchar();
+                break;
+            }
+
+            remove(VAULT_FILENAME);
+            rename("temp.txt", VAULT_FILENAME);
+    
+            typewriter("\n>> NOTE ", 50);
+            printf("[%d]", targetIndex);
+            typewriter("HAS BEEN DELETED\n", 50);
+            getchar();
+            break;
+        case 'N':
+            typewriter("HALTING DELETION...", 50);
+            getchar();
+            break;
+        default:
+            typewriter("UNRECOGNIZED INPUT...", 50);
+            getchar();
+            break;
+    }
+
+    if (usrChoice != 'Y')
+    {
+        fclose(file);
+        fclose(source);
+        fclose(temp);
+        remove("temp.txt");
+    }
+
+}
+
+
+
+/*--------------------------
+|   MAIN FUNCTION
++-------------------------*/
+int main(int argc, char *argv[])
+{
+    int usrChoice = 0;
+
+    initCrc32c();
+
+    // Unattended integrity check, exit code 1 if anything is damaged
+    // (or, with --strict, has no checksum)
+    if (argc > 1 && strcmp(argv[1], "--verify") == 0)
+    {
+        int strict = (argc > 2 && strcmp(argv[2], "--strict") == 0);
+        return verifyVault(strict) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    system("cls");
+    system("color 0a");
+
+    Beep(1000,500);
+    const char *message = "ACCESS GRANTED. WELCOME TO ENIGMA VAULT...\n";
+    typewriter(message, 50); // 50ms delay per character
+
+    while(1)
+    {
+        printMenu();
+
+        scanf(" %d", &usrChoice);
+
+        switch(usrChoice)
+        {
+            case 1:
+                typewriter(">> CREATING NEW ENCRYPTED NOTE...\n", 50);
+                Sleep(1500);
+                checkFile();
+                cleanInput();
+                createNote();
+                break;
+            case 2:
+                typewriter(">> DECRYPTING NOTE...\n", 50);
+                Sleep(1500);
+                cleanInput();
                 checkFile();
                 decryptNote();
                 break;
@@ -697,6 +2193,20 @@ int main()
                 deleteNote();
                 break;
             case 5:
+                typewriter(">> VERIFYING VAULT...\n", 50);
+                Sleep(1500);
+                cleanInput();
+                checkFile();
+                verifyVault(0);
+                break;
+            case 6:
+                typewriter(">> RE-KEYING VAULT...\n", 50);
+                Sleep(1500);
+                cleanInput();
+                checkFile();
+                rekeyVault();
+                break;
+            case 7:
                 exit(0);
             default:
                 printf("UNRECOGNIZED INPUT...RETRY...\n");